@@ -2,6 +2,11 @@
 #include <algorithm>
 #include <functional>
 #include <cstring>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <climits>
 #include <assert.h>
 #include <math.h>
 #include <stdint.h>
@@ -36,16 +41,20 @@ static const int max_rooms = 16;
 static const range_t room_width{7, 10};
 static const range_t room_height{5, 7};
 
-static room_t rooms[max_rooms];
-static int n_rooms = 0;
-static int next_region = 0;
+// Generator state is per thread so several dungeons can be generated at once
+// (see generate_speculative()).
+static thread_local room_t rooms[max_rooms];
+static thread_local int n_rooms = 0;
+static thread_local int next_region = 0;
 
-static tile_t tiles[width][height];
+static thread_local tile_t tiles[width][height];
 
-static bool animate_make_connections = true;
-static bool animate_make_maze = true;
-static bool animate_make_rooms = true;
-static bool animate_remove_dead_ends = true;
+static thread_local bool animate_make_connections = true;
+static thread_local bool animate_make_maze = true;
+static thread_local bool animate_make_rooms = true;
+static thread_local bool animate_remove_dead_ends = true;
+
+static thread_local uint32_t random_state = 1;
 
 void benchmark(const char *name, std::function<void()> fn) {
     clock_t bench = clock();
@@ -56,8 +65,32 @@ void benchmark(const char *name, std::function<void()> fn) {
 }
 
 
+// https://stackoverflow.com/a/12996028
+uint32_t hash(uint32_t x) {
+    x = ((x >> 16) ^ x) * 0x45d9f3b;
+    x = ((x >> 16) ^ x) * 0x45d9f3b;
+    x = (x >> 16) ^ x;
+    return x;
+}
+
+void seed_random(uint32_t seed) {
+    random_state = hash(seed ^ 0x9e3779b9);
+    if (random_state == 0)
+        random_state = 1;
+}
+
+// xorshift32, so every thread gets its own reproducible stream
+uint32_t next_random() {
+    uint32_t x = random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random_state = x;
+    return x;
+}
+
 int randrange(range_t r) {
-    return r.lo + rand()%(r.hi-r.lo+1);
+    return r.lo + next_random()%(r.hi-r.lo+1);
 }
 
 template <typename T>
@@ -114,14 +147,6 @@ float random_float(uint32_t random_int) {
     return x - 1.0f;
 }
 
-// https://stackoverflow.com/a/12996028
-uint32_t hash(uint32_t x) {
-    x = ((x >> 16) ^ x) * 0x45d9f3b;
-    x = ((x >> 16) ^ x) * 0x45d9f3b;
-    x = (x >> 16) ^ x;
-    return x;
-}
-
 // https://www.rapidtables.com/convert/color/hsv-to-rgb.html
 void hsv2rgb(float h, float s, float v, uint8_t& r, uint8_t& g, uint8_t& b) {
     float c = v*s;
@@ -678,6 +703,7 @@ void remove_dead_ends() {
                     delay(1);
                 }
                 tiles[x][y].kind = tk_wall;
+                tiles[x][y].door = false;
                 dead_ends_removed += 1;
             }
         }
@@ -685,8 +711,616 @@ void remove_dead_ends() {
     } while (dead_ends_removed != 0);
 }
 
+enum {
+    phase_rooms,
+    phase_maze,
+    phase_connections,
+    phase_done
+};
+
+// Called after each phase with the current thread's rooms/tiles filled in.
+// Return false to throw the level away.
+typedef std::function<bool(int phase)> constraint_t;
+
+struct dungeon_t {
+    int n_rooms;
+    room_t rooms[max_rooms];
+    tile_t tiles[width][height];
+};
+
+void save_dungeon(dungeon_t& d) {
+    d.n_rooms = n_rooms;
+    memcpy(d.rooms, rooms, sizeof(rooms));
+    memcpy(d.tiles, tiles, sizeof(tiles));
+}
+
+void load_dungeon(const dungeon_t& d) {
+    n_rooms = d.n_rooms;
+    memcpy(rooms, d.rooms, sizeof(rooms));
+    memcpy(tiles, d.tiles, sizeof(tiles));
+}
+
+int count_doors() {
+    int doors = 0;
+    for (int x=0; x<width; ++x)
+    for (int y=0; y<height; ++y) {
+        if (tiles[x][y].door)
+            doors += 1;
+    }
+    return doors;
+}
+
+// Walking distance between the two rooms that are farthest apart,
+// measured centre to centre. Rooms that can't reach each other are ignored.
+int farthest_rooms_distance() {
+    std::vector<int> dist(width*height);
+    std::vector<xy_t> queue;
+    int farthest = 0;
+    
+    for (int i=0; i<n_rooms; ++i) {
+        room_t r = rooms[i];
+        xy_t start{(r.x0+r.x1)/2, (r.y0+r.y1)/2};
+        
+        std::fill(dist.begin(), dist.end(), -1);
+        queue.clear();
+        queue.push_back(start);
+        dist[start.x*height + start.y] = 0;
+        
+        for (size_t head=0; head<queue.size(); ++head) {
+            xy_t p = queue[head];
+            static const xy_t dirs[] = { xy_t{-1,0}, xy_t{1,0}, xy_t{0,-1}, xy_t{0,1} };
+            for (int d=0; d<4; ++d) {
+                int nx = p.x+dirs[d].x;
+                int ny = p.y+dirs[d].y;
+                if (nx<0 || nx>=width || ny<0 || ny>=height)
+                    continue;
+                if (tiles[nx][ny].kind != tk_floor || dist[nx*height + ny] >= 0)
+                    continue;
+                dist[nx*height + ny] = dist[p.x*height + p.y] + 1;
+                queue.push_back(xy_t{nx, ny});
+            }
+        }
+        
+        for (int j=i+1; j<n_rooms; ++j) {
+            room_t o = rooms[j];
+            int d = dist[((o.x0+o.x1)/2)*height + (o.y0+o.y1)/2];
+            farthest = std::max(farthest, d);
+        }
+    }
+    
+    return farthest;
+}
+
+// Generates one level from seed, stopping early as soon as accept() rejects it.
+bool generate(uint32_t seed, constraint_t accept) {
+    seed_random(seed);
+    init();
+    
+    make_rooms();
+    if (!accept(phase_rooms))
+        return false;
+    
+    make_maze();
+    if (!accept(phase_maze))
+        return false;
+    
+    make_connections();
+    if (!accept(phase_connections))
+        return false;
+    
+    remove_dead_ends();
+    return accept(phase_done);
+}
+
+// Tries seeds first_seed, first_seed+1, ... on all cores at once and loads the
+// first one accept() is happy with into this thread's tiles. "First" means
+// lowest seed, not whichever thread finished first, so the result is the same
+// as retrying one seed after another. Candidates above the current best are
+// abandoned at the next phase boundary.
+bool generate_speculative(constraint_t accept, uint32_t first_seed, int max_candidates, uint32_t& seed) {
+    std::atomic<int> next_candidate{0};
+    std::atomic<int> best{max_candidates};
+    std::mutex winner_mutex;
+    dungeon_t winner;
+    
+    auto worker = [&]() {
+        animate_make_connections = false;
+        animate_make_maze = false;
+        animate_make_rooms = false;
+        animate_remove_dead_ends = false;
+        
+        for (;;) {
+            // candidates are handed out in order, so once one is past the
+            // best so far none of the following ones can win either
+            int i = next_candidate++;
+            if (i >= best)
+                break;
+            
+            bool ok = generate(first_seed+i, [&](int phase) {
+                return i < best && accept(phase);
+            });
+            if (!ok)
+                continue;
+            
+            std::lock_guard<std::mutex> lock(winner_mutex);
+            if (i < best) {
+                best = i;
+                save_dungeon(winner);
+            }
+        }
+    };
+    
+    int n_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (int i=0; i<n_threads; ++i)
+        threads.push_back(std::thread(worker));
+    for (std::thread& t: threads)
+        t.join();
+    
+    if (best == max_candidates)
+        return false;
+    
+    load_dungeon(winner);
+    seed = first_seed+best;
+    return true;
+}
+
+enum {
+    nk_room,
+    nk_door,
+    nk_junction
+};
+
+struct nav_node_t {
+    char kind;
+    char room;
+    int x, y;
+};
+
+// Where a plain corridor tile sits: the nodes at either end of its corridor
+// and how far away each one is.
+struct nav_corridor_t {
+    int node[2];
+    int dist[2];
+};
+
+// The finished level boiled down to rooms, doors and corridor junctions, with
+// corridors between them as weighted edges. A room node stands for the room's
+// centre tile; doors of the same room are also joined directly by the real
+// walk across the room, so distances are exact walking distances.
+struct nav_graph_t {
+    std::vector<nav_node_t> nodes;
+    
+    // edges of node i are targets/weights[offsets[i] .. offsets[i+1])
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<int> weights;
+    
+    // distance from landmarks[l] to node i is landmark_dist[l*nodes.size() + i]
+    std::vector<int> landmarks;
+    std::vector<int> landmark_dist;
+    
+    // node for each tile (x*height + y), -1 for walls and plain corridor
+    std::vector<int> node_at;
+    
+    // for plain corridor tiles (node_at == -1), node[0] is -1 everywhere else
+    std::vector<nav_corridor_t> corridor_at;
+};
+
+static const int max_landmarks = 8;
+static const int nav_unreachable = INT_MAX;
+
+void nav_dijkstra(const nav_graph_t& g, int source, int* dist) {
+    typedef std::pair<int, int> entry_t; // distance, node
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> open;
+    
+    std::fill(dist, dist+g.nodes.size(), nav_unreachable);
+    dist[source] = 0;
+    open.push(entry_t{0, source});
+    
+    while (!open.empty()) {
+        entry_t e = open.top();
+        open.pop();
+        if (e.first != dist[e.second])
+            continue;
+        for (int i=g.offsets[e.second]; i<g.offsets[e.second+1]; ++i) {
+            int d = e.first + g.weights[i];
+            if (d < dist[g.targets[i]]) {
+                dist[g.targets[i]] = d;
+                open.push(entry_t{d, g.targets[i]});
+            }
+        }
+    }
+}
+
+void make_nav_graph(nav_graph_t& g) {
+    g.nodes.clear();
+    g.node_at.assign(width*height, -1);
+    g.corridor_at.assign(width*height, nav_corridor_t{{-1, -1}, {0, 0}});
+    
+    for (int i=0; i<n_rooms; ++i) {
+        room_t r = rooms[i];
+        g.nodes.push_back(nav_node_t{nk_room, (char)i, (r.x0+r.x1)/2, (r.y0+r.y1)/2});
+    }
+    
+    static const xy_t dirs[] = { xy_t{-1,0}, xy_t{1,0}, xy_t{0,-1}, xy_t{0,1} };
+    
+    for (int x=1; x<width-1; ++x)
+    for (int y=1; y<height-1; ++y) {
+        tile_t t = tiles[x][y];
+        if (t.kind != tk_floor)
+            continue;
+        
+        if (t.door) {
+            g.node_at[x*height + y] = g.nodes.size();
+            g.nodes.push_back(nav_node_t{nk_door, -1, x, y});
+        } else if (t.room >= 0) {
+            g.node_at[x*height + y] = t.room;
+        } else {
+            int floor_neighbours = 0;
+            for (int d=0; d<4; ++d) {
+                if (tiles[x+dirs[d].x][y+dirs[d].y].kind == tk_floor)
+                    floor_neighbours += 1;
+            }
+            if (floor_neighbours >= 3) {
+                g.node_at[x*height + y] = g.nodes.size();
+                g.nodes.push_back(nav_node_t{nk_junction, -1, x, y});
+            }
+        }
+    }
+    
+    // Follow every corridor leaving a node tile until it reaches another node.
+    // Each corridor gets walked from both ends, which gives both directions.
+    struct edge_t { int from, to, weight; };
+    std::vector<edge_t> edges;
+    
+    // doors opening into each room, with the side of the room they're on
+    struct room_door_t { int node, side; };
+    std::vector<std::vector<room_door_t>> room_doors(n_rooms);
+    std::vector<xy_t> corridor;
+    
+    auto room_offset = [&](int node, int x, int y) {
+        nav_node_t n = g.nodes[node];
+        return n.kind == nk_room ? abs(n.x-x) + abs(n.y-y) : 0;
+    };
+    
+    for (int x=1; x<width-1; ++x)
+    for (int y=1; y<height-1; ++y) {
+        int from = g.node_at[x*height + y];
+        if (from < 0)
+            continue;
+        
+        for (int d=0; d<4; ++d) {
+            int px = x, py = y;
+            int cx = x+dirs[d].x, cy = y+dirs[d].y;
+            int length = 1;
+            corridor.clear();
+            
+            while (tiles[cx][cy].kind == tk_floor && g.node_at[cx*height + cy] < 0) {
+                corridor.push_back(xy_t{cx, cy});
+                int nx = -1, ny = -1;
+                for (int e=0; e<4; ++e) {
+                    int ex = cx+dirs[e].x, ey = cy+dirs[e].y;
+                    if (tiles[ex][ey].kind == tk_floor && (ex != px || ey != py)) {
+                        nx = ex;
+                        ny = ey;
+                    }
+                }
+                if (nx < 0)
+                    break;
+                px = cx;  py = cy;
+                cx = nx;  cy = ny;
+                length += 1;
+            }
+            
+            if (tiles[cx][cy].kind != tk_floor)
+                continue;
+            int to = g.node_at[cx*height + cy];
+            if (to < 0 || to == from)
+                continue;
+            
+            if (g.nodes[from].kind == nk_room && g.nodes[to].kind == nk_door && length == 1)
+                room_doors[from].push_back(room_door_t{to, d});
+            
+            int start = room_offset(from, x, y);
+            length += start + room_offset(to, cx, cy);
+            edges.push_back(edge_t{from, to, length});
+            
+            if (from < to) {
+                for (size_t i=0; i<corridor.size(); ++i) {
+                    int along = start + i + 1;
+                    nav_corridor_t& c = g.corridor_at[corridor[i].x*height + corridor[i].y];
+                    c = nav_corridor_t{{from, to}, {along, length-along}};
+                }
+            }
+        }
+    }
+    
+    // Going straight from door to door across a room is as short as the
+    // Manhattan distance, except that two doors on the same wall need one
+    // step in and one step out.
+    for (int r=0; r<n_rooms; ++r)
+    for (room_door_t a: room_doors[r])
+    for (room_door_t b: room_doors[r]) {
+        if (a.node == b.node)
+            continue;
+        nav_node_t na = g.nodes[a.node];
+        nav_node_t nb = g.nodes[b.node];
+        int length = abs(na.x-nb.x) + abs(na.y-nb.y);
+        if (a.side == b.side)
+            length += 2;
+        edges.push_back(edge_t{a.node, b.node, length});
+    }
+    
+    // keep only the shortest edge between any two nodes
+    std::sort(edges.begin(), edges.end(), [](const edge_t& a, const edge_t& b) {
+        if (a.from != b.from) return a.from < b.from;
+        if (a.to != b.to) return a.to < b.to;
+        return a.weight < b.weight;
+    });
+    
+    int n_nodes = g.nodes.size();
+    g.offsets.assign(n_nodes+1, 0);
+    g.targets.clear();
+    g.weights.clear();
+    for (size_t i=0; i<edges.size(); ++i) {
+        edge_t e = edges[i];
+        if (i > 0 && edges[i-1].from == e.from && edges[i-1].to == e.to)
+            continue;
+        g.offsets[e.from+1] += 1;
+        g.targets.push_back(e.to);
+        g.weights.push_back(e.weight);
+    }
+    for (int i=0; i<n_nodes; ++i)
+        g.offsets[i+1] += g.offsets[i];
+    
+    // Landmarks for the ALT heuristic, picked farthest-first: each new one is
+    // the node farthest from all the landmarks chosen so far.
+    g.landmarks.clear();
+    g.landmark_dist.clear();
+    if (n_nodes == 0)
+        return;
+    
+    std::vector<int> dist(n_nodes);
+    std::vector<int> nearest(n_nodes, nav_unreachable);
+    nav_dijkstra(g, 0, dist.data());
+    int next = 0;
+    for (int i=0; i<n_nodes; ++i) {
+        if (dist[i] != nav_unreachable && dist[i] > dist[next])
+            next = i;
+    }
+    
+    while ((int)g.landmarks.size() < std::min(max_landmarks, n_nodes)) {
+        g.landmarks.push_back(next);
+        g.landmark_dist.resize(g.landmarks.size()*n_nodes);
+        int* ld = &g.landmark_dist[(g.landmarks.size()-1)*n_nodes];
+        nav_dijkstra(g, next, ld);
+        
+        next = -1;
+        for (int i=0; i<n_nodes; ++i) {
+            nearest[i] = std::min(nearest[i], ld[i]);
+            if (nearest[i] == 0)
+                continue;
+            if (next < 0 || nearest[i] > nearest[next])
+                next = i;
+        }
+        if (next < 0)
+            break;
+    }
+}
+
+// A* over the nav graph with the landmark lower bound as heuristic.
+// Returns -1 if there is no path.
+int nav_distance(const nav_graph_t& g, int from, int to) {
+    int n_nodes = g.nodes.size();
+    
+    auto heuristic = [&](int node) {
+        int h = 0;
+        for (size_t l=0; l<g.landmarks.size(); ++l) {
+            int a = g.landmark_dist[l*n_nodes + node];
+            int b = g.landmark_dist[l*n_nodes + to];
+            if (a != nav_unreachable && b != nav_unreachable)
+                h = std::max(h, abs(a-b));
+        }
+        return h;
+    };
+    
+    typedef std::pair<int, int> entry_t; // estimate, node
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> open;
+    std::vector<int> dist(n_nodes, nav_unreachable);
+    
+    dist[from] = 0;
+    open.push(entry_t{heuristic(from), from});
+    
+    while (!open.empty()) {
+        int node = open.top().second;
+        int estimate = open.top().first;
+        open.pop();
+        if (node == to)
+            return dist[to];
+        if (estimate != dist[node] + heuristic(node))
+            continue;
+        for (int i=g.offsets[node]; i<g.offsets[node+1]; ++i) {
+            int n = g.targets[i];
+            int d = dist[node] + g.weights[i];
+            if (d < dist[n]) {
+                dist[n] = d;
+                open.push(entry_t{d + heuristic(n), n});
+            }
+        }
+    }
+    
+    return -1;
+}
+
+// Distance from any floor tile to node to, for agents that aren't standing
+// on a node. Returns -1 if there is no path.
+int nav_tile_distance(const nav_graph_t& g, int x, int y, int to) {
+    int best = -1;
+    auto consider = [&](int node, int offset) {
+        int d = nav_distance(g, node, to);
+        if (d >= 0 && (best < 0 || offset+d < best))
+            best = offset+d;
+    };
+    
+    int node = g.node_at[x*height + y];
+    if (node >= 0 && g.nodes[node].kind == nk_room) {
+        // leave through whichever door is best, or walk to the centre
+        nav_node_t n = g.nodes[node];
+        if (node == to)
+            return abs(n.x-x) + abs(n.y-y);
+        for (int i=g.offsets[node]; i<g.offsets[node+1]; ++i) {
+            nav_node_t door = g.nodes[g.targets[i]];
+            consider(g.targets[i], abs(door.x-x) + abs(door.y-y));
+        }
+    } else if (node >= 0) {
+        consider(node, 0);
+    } else {
+        nav_corridor_t c = g.corridor_at[x*height + y];
+        if (c.node[0] < 0)
+            return -1;
+        consider(c.node[0], c.dist[0]);
+        consider(c.node[1], c.dist[1]);
+    }
+    
+    return best;
+}
+
+// A giant map stitched together from cells_x * cells_y macro-cells, each one
+// an ordinary width x height level generated on its own thread. Neighbouring
+// macro-cells share their border row/column, and a coarse spanning tree
+// decides which shared edges get a portal door. Tile region/room numbers are
+// local to the macro-cell they came from.
+struct giant_map_t {
+    int cells_x, cells_y;
+    int width, height;
+    std::vector<tile_t> tiles; // x*height + y
+    
+    // portal offset along each macro-cell's east/south edge, -1 for none
+    std::vector<int> east_portals;
+    std::vector<int> south_portals;
+};
+
+void make_skeleton(giant_map_t& map) {
+    int n_cells = map.cells_x*map.cells_y;
+    map.east_portals.assign(n_cells, -1);
+    map.south_portals.assign(n_cells, -1);
+    
+    // portals sit on odd offsets, where the maze and room floors are
+    range_t east_offset{0, (height-3)/2};
+    range_t south_offset{0, (width-3)/2};
+    
+    std::vector<bool> visited(n_cells, false);
+    std::vector<int> stack;
+    visited[0] = true;
+    stack.push_back(0);
+    
+    while (!stack.empty()) {
+        int c = stack.back();
+        int cx = c%map.cells_x;
+        int cy = c/map.cells_x;
+        
+        int ns[4];
+        int n = 0;
+        if (cx > 0 && !visited[c-1])                     ns[n++] = c-1;
+        if (cx < map.cells_x-1 && !visited[c+1])         ns[n++] = c+1;
+        if (cy > 0 && !visited[c-map.cells_x])           ns[n++] = c-map.cells_x;
+        if (cy < map.cells_y-1 && !visited[c+map.cells_x]) ns[n++] = c+map.cells_x;
+        
+        if (n == 0) {
+            stack.pop_back();
+            continue;
+        }
+        
+        int next = ns[randrange(range_t{0, n-1})];
+        if (next == c+1)                map.east_portals[c]     = randrange(east_offset)*2+1;
+        if (next == c-1)                map.east_portals[next]  = randrange(east_offset)*2+1;
+        if (next == c+map.cells_x)      map.south_portals[c]    = randrange(south_offset)*2+1;
+        if (next == c-map.cells_x)      map.south_portals[next] = randrange(south_offset)*2+1;
+        
+        visited[next] = true;
+        stack.push_back(next);
+    }
+}
+
+void make_macro_cell(giant_map_t& map, int cx, int cy, uint32_t seed) {
+    int c = cy*map.cells_x + cx;
+    seed_random(seed ^ hash(c+1));
+    init();
+    make_rooms();
+    make_maze();
+    make_connections();
+    
+    // Open this macro-cell's side of its portals before culling, so the
+    // corridors leading up to them aren't removed as dead ends.
+    int portals[4][3] = {
+        { map.east_portals[c], width-1, -1 },
+        { cx > 0 ? map.east_portals[c-1] : -1, 0, -1 },
+        { map.south_portals[c], -1, height-1 },
+        { cy > 0 ? map.south_portals[c-map.cells_x] : -1, -1, 0 },
+    };
+    for (int i=0; i<4; ++i) {
+        if (portals[i][0] < 0)
+            continue;
+        int x = portals[i][1] >= 0 ? portals[i][1] : portals[i][0];
+        int y = portals[i][2] >= 0 ? portals[i][2] : portals[i][0];
+        tiles[x][y].kind = tk_floor;
+        tiles[x][y].door = true;
+    }
+    
+    remove_dead_ends();
+    
+    // The shared border column/row belongs to the macro-cell east/south of
+    // it, so no two threads ever write the same tile.
+    int owned_w = cx == map.cells_x-1 ? width  : width-1;
+    int owned_h = cy == map.cells_y-1 ? height : height-1;
+    int x0 = cx*(width-1);
+    int y0 = cy*(height-1);
+    for (int x=0; x<owned_w; ++x) {
+        memcpy(&map.tiles[(size_t)(x0+x)*map.height + y0], &tiles[x][0], owned_h*sizeof(tile_t));
+    }
+}
+
+// Generates a map at least min_width x min_height tiles big. Each macro-cell
+// only ever touches its thread's width x height tile grid, which stays in
+// cache, and its recursion depth in walk() is bounded by the macro-cell size.
+void make_giant_map(giant_map_t& map, int min_width, int min_height, uint32_t seed) {
+    map.cells_x = std::max(1, (min_width-1  + width-2)  / (width-1));
+    map.cells_y = std::max(1, (min_height-1 + height-2) / (height-1));
+    map.width  = map.cells_x*(width-1)  + 1;
+    map.height = map.cells_y*(height-1) + 1;
+    map.tiles.resize((size_t)map.width*map.height);
+    
+    // the skeleton gets its own stream, the caller's is left as it was
+    uint32_t saved_state = random_state;
+    seed_random(seed);
+    make_skeleton(map);
+    random_state = saved_state;
+    
+    std::atomic<int> next_cell{0};
+    int n_cells = map.cells_x*map.cells_y;
+    
+    auto worker = [&]() {
+        animate_make_connections = false;
+        animate_make_maze = false;
+        animate_make_rooms = false;
+        animate_remove_dead_ends = false;
+        
+        for (int c = next_cell++; c < n_cells; c = next_cell++) {
+            make_macro_cell(map, c%map.cells_x, c/map.cells_x, seed);
+        }
+    };
+    
+    int n_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (int i=0; i<n_threads; ++i)
+        threads.push_back(std::thread(worker));
+    for (std::thread& t: threads)
+        t.join();
+}
+
 int main() {
-    srand(time(0));
+    seed_random(time(0));
     terminal_open();
     terminal_setf("window.size=%dx%d", width, height);
     // terminal_set("window.cellsize=16x16");